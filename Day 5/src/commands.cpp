@@ -0,0 +1,285 @@
+#include "commands.hpp"
+#include "mirror.hpp"
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <vector>
+#include <sys/stat.h>   // chmod()
+#include <pwd.h>        // getpwuid_r()
+#include <grp.h>        // getgrgid_r()
+#include <cstring>      // strerror()
+#include <cerrno>       // errno
+
+namespace fs = std::filesystem;
+
+// ===== Helper: Format Permissions =====
+std::string format_permissions(fs::perms p) {
+    auto test = [&](fs::perms bit, char c) {
+        return ((p & bit) != fs::perms::none) ? c : '-';
+    };
+    std::string s;
+    s += test(fs::perms::owner_read, 'r');
+    s += test(fs::perms::owner_write, 'w');
+    s += test(fs::perms::owner_exec, 'x');
+    s += test(fs::perms::group_read, 'r');
+    s += test(fs::perms::group_write, 'w');
+    s += test(fs::perms::group_exec, 'x');
+    s += test(fs::perms::others_read, 'r');
+    s += test(fs::perms::others_write, 'w');
+    s += test(fs::perms::others_exec, 'x');
+    return s;
+}
+
+// ===== Helper: Show file info with owner/group =====
+void show_permissions(const fs::path& file, std::ostream& out) {
+    try {
+        if (!fs::exists(file)) {
+            out << "No such file or directory: " << file.string() << "\n";
+            return;
+        }
+        fs::perms p = fs::status(file).permissions();
+        std::string perm_str = format_permissions(p);
+
+#ifndef _WIN32
+        struct stat sb;
+        if (stat(file.c_str(), &sb) == 0) {
+            // Reentrant lookups: the daemon runs commands on several threads.
+            char buf[4096];
+            struct passwd pwd, *pw = nullptr;
+            struct group  grp, *gr = nullptr;
+            getpwuid_r(sb.st_uid, &pwd, buf, sizeof(buf) / 2, &pw);
+            getgrgid_r(sb.st_gid, &grp, buf + sizeof(buf) / 2, sizeof(buf) / 2, &gr);
+            out << perm_str << "  "
+                << (pw ? pw->pw_name : "?") << ":"
+                << (gr ? gr->gr_name : "?") << "  "
+                << (fs::is_directory(file) ? "<DIR>" : std::to_string(fs::file_size(file)))
+                << "  " << file.filename().string() << "\n";
+        } else {
+            out << perm_str << "  " << file.filename().string() << "\n";
+        }
+#else
+        out << perm_str << "  " << file.filename().string() << "\n";
+#endif
+    } catch (const std::exception& e) {
+        out << "Error reading permissions: " << e.what() << "\n";
+    }
+}
+
+// ===== Helper: Change file permissions =====
+bool change_permissions(const fs::path& path, const std::string& octal, std::ostream& out) {
+#ifndef _WIN32
+    char* end;
+    long mode = strtol(octal.c_str(), &end, 8);
+    if (end == octal.c_str() || *end != '\0') {
+        out << "Invalid octal mode. Use like 644 or 755.\n";
+        return false;
+    }
+    if (::chmod(path.c_str(), static_cast<mode_t>(mode)) != 0) {
+        out << "chmod failed: " << strerror(errno) << "\n";
+        return false;
+    }
+    return true;
+#else
+    out << "Permission changes not supported on Windows.\n";
+    return false;
+#endif
+}
+
+// ===== Helper: Recursive name search =====
+void find_pattern(const fs::path& base, const std::string& pattern, std::ostream& out) {
+    try {
+        for (auto& p : fs::recursive_directory_iterator(base)) {
+            if (!out) return;   // output was cut off; stop walking
+            if (p.path().filename().string().find(pattern) != std::string::npos) {
+                out << p.path().string() << "\n";
+            }
+        }
+    } catch (const std::exception& e) {
+        out << "Find error: " << e.what() << "\n";
+    }
+}
+
+// ===== Helper: Output redirection =====
+enum RedirectType { NONE, OVERWRITE, APPEND };
+struct ParsedCmd {
+    std::string cmd;
+    RedirectType redirect = NONE;
+    std::string filename;
+};
+
+ParsedCmd parse_redirect(const std::string& line) {
+    ParsedCmd res;
+    size_t pos = line.find(">>");
+    if (pos != std::string::npos) {
+        res.cmd = line.substr(0, pos);
+        res.filename = line.substr(pos + 2);
+        res.redirect = APPEND;
+    } else {
+        pos = line.find(">");
+        if (pos != std::string::npos) {
+            res.cmd = line.substr(0, pos);
+            res.filename = line.substr(pos + 1);
+            res.redirect = OVERWRITE;
+        } else {
+            res.cmd = line;
+            res.redirect = NONE;
+        }
+    }
+
+    auto trim = [](std::string &s) {
+        s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](unsigned char ch){ return !std::isspace(ch); }));
+        s.erase(std::find_if(s.rbegin(), s.rend(), [](unsigned char ch){ return !std::isspace(ch); }).base(), s.end());
+    };
+    trim(res.cmd);
+    trim(res.filename);
+    return res;
+}
+
+// ===== Command Dispatch =====
+static bool dispatch_command(const std::string& line, Session& session, std::ostream& out) {
+    fs::path& current = session.current;
+
+    if (line.empty()) return true;
+
+    if (line == "exit") return false;
+
+    // ===== Basic Commands =====
+    else if (line == "pwd") out << current.string() << "\n";
+
+    else if (line == "ls") {
+        DirCache::Listing entries = session.cache
+            ? session.cache->get(current.string(), out)
+            : std::make_shared<const std::vector<Entry>>(list_directory(current.string(), out));
+        out << std::left << std::setw(11) << "PERMS"
+            << std::setw(10) << "SIZE" << "NAME\n";
+        out << "---------------------------------------\n";
+        for (auto& e : *entries) {
+            if (!out) break;
+            std::string perms = format_permissions(e.perms);
+            std::string size = e.is_dir ? "<DIR>" : std::to_string(e.size);
+            out << std::left << std::setw(11) << perms
+                << std::setw(10) << size << e.name << "\n";
+        }
+    }
+
+    else if (line.rfind("cd ", 0) == 0) {
+        std::string dir = line.substr(3);
+        fs::path newp = (dir == "..") ? current.parent_path() : current / dir;
+        if (fs::exists(newp) && fs::is_directory(newp)) current = fs::canonical(newp);
+        else out << "No such directory.\n";
+    }
+
+    // ===== File Commands =====
+    else if (line.rfind("touch ", 0) == 0) {
+        std::string f = line.substr(6);
+        std::ofstream(current / f);
+    }
+
+    else if (line.rfind("mkdir ", 0) == 0) {
+        std::string d = line.substr(6);
+        std::error_code ec;
+        fs::create_directory(current / d, ec);
+        if (ec) out << "mkdir failed: " << ec.message() << "\n";
+    }
+
+    else if (line.rfind("cp ", 0) == 0) {
+        std::stringstream ss(line.substr(3));
+        std::string src, dst; ss >> src >> dst;
+        try { fs::copy_file(current / src, current / dst, fs::copy_options::overwrite_existing); }
+        catch (...) { out << "Copy failed.\n"; }
+    }
+
+    else if (line.rfind("mirror ", 0) == 0) {
+        std::stringstream ss(line.substr(7));
+        std::string src, dst; ss >> src >> dst;
+        if (src.empty() || dst.empty()) out << "Usage: mirror <src> <dst>\n";
+        else mirror_tree(current / src, current / dst, out, session.threads);
+    }
+
+    else if (line.rfind("mv ", 0) == 0) {
+        std::stringstream ss(line.substr(3));
+        std::string src, dst; ss >> src >> dst;
+        try { fs::rename(current / src, current / dst); }
+        catch (...) { out << "Move failed.\n"; }
+    }
+
+    else if (line.rfind("rm ", 0) == 0) {
+        std::string t = line.substr(3);
+        fs::path target = current / t;
+        try {
+            if (fs::is_directory(target)) fs::remove_all(target);
+            else fs::remove(target);
+        } catch (...) { out << "Remove failed.\n"; }
+    }
+
+    else if (line.rfind("find ", 0) == 0) {
+        std::string pat = line.substr(5);
+        find_pattern(current, pat, out);
+    }
+
+    // ===== Permission Commands =====
+    else if (line.rfind("perms ", 0) == 0) {
+        std::string target = line.substr(6);
+        fs::path f = current / target;
+        show_permissions(f, out);
+    }
+
+    else if (line.rfind("perm ", 0) == 0) {
+        std::stringstream ss(line.substr(5));
+        std::string file, mode;
+        ss >> file >> mode;
+        if (file.empty() || mode.empty()) {
+            out << "Usage: perm <file> <octal_mode>\n";
+            return true;
+        }
+        fs::path f = current / file;
+        if (!fs::exists(f)) {
+            out << "File not found: " << file << "\n";
+            return true;
+        }
+        if (change_permissions(f, mode, out)) {
+            // A chmod does not touch the directory mtime, so drop the listing.
+            if (session.cache) session.cache->invalidate(f.parent_path().string());
+            out << "Permissions changed for " << file << " to " << mode << "\n";
+        }
+    }
+
+    else if (line == "help") {
+        out << "Available commands:\n"
+            << "  ls               - List files\n"
+            << "  cd <dir>         - Change directory\n"
+            << "  pwd              - Print working directory\n"
+            << "  touch <file>     - Create an empty file\n"
+            << "  mkdir <dir>      - Create a directory\n"
+            << "  cp <src> <dst>   - Copy a file\n"
+            << "  mv <src> <dst>   - Move or rename\n"
+            << "  rm <path>        - Remove a file or directory\n"
+            << "  find <pattern>   - Search names below here\n"
+            << "  mirror <s> <d>   - Incrementally copy a tree\n"
+            << "  perms <file>     - View file permissions\n"
+            << "  perm <f> <octal> - Change file permissions\n"
+            << "  exit             - Exit program\n"
+            << "  <cmd> > file     - Redirect output (>> appends)\n";
+    }
+
+    else out << "Unknown command. Type 'help' for a list.\n";
+
+    return true;
+}
+
+bool run_command(const std::string& rawline, Session& session, std::ostream& out) {
+    ParsedCmd parsed = parse_redirect(rawline);
+    if (parsed.redirect == NONE) return dispatch_command(parsed.cmd, session, out);
+
+    std::ostringstream output;
+    bool keep = dispatch_command(parsed.cmd, session, output);
+    fs::path file = session.current / parsed.filename;
+    std::ofstream ofs(file, parsed.redirect == OVERWRITE ? std::ofstream::trunc : std::ofstream::app);
+    ofs << output.str();
+    out << "Output redirected to " << file.string() << "\n";
+    return keep;
+}
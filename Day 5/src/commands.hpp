@@ -0,0 +1,18 @@
+#pragma once
+#include "explorer.hpp"
+#include <filesystem>
+#include <ostream>
+#include <string>
+
+class ThreadBudget;
+
+// Per-user state for one interactive or daemon session.
+struct Session {
+    std::filesystem::path current;
+    DirCache* cache = nullptr;   // shared listing cache, or nullptr to read directly
+    ThreadBudget* threads = nullptr;   // shared cap on mirror's helper threads
+};
+
+// Runs one command line against the session, writing all output to out.
+// Returns false when the session should end ("exit").
+bool run_command(const std::string& line, Session& session, std::ostream& out);
@@ -0,0 +1,539 @@
+#include "daemon.hpp"
+#include "commands.hpp"
+#include "protocol.hpp"
+#include "mirror.hpp"
+#include <filesystem>
+#include <iostream>
+#include <streambuf>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <csignal>
+#include <cstring>      // strerror()
+#include <cerrno>       // errno
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>   // umask()
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// ===== Worker -> event loop hand-off =====
+struct Reply {
+    std::uint64_t client;
+    proto::FrameType type;
+    std::string payload;
+    bool quit = false;
+};
+
+class ReplyQueue {
+public:
+    explicit ReplyQueue(int efd) : efd_(efd) {}
+
+    void push(Reply r) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            replies_.push_back(std::move(r));
+        }
+        std::uint64_t one = 1;
+        ssize_t n = ::write(efd_, &one, sizeof(one));
+        (void)n;
+    }
+
+    std::vector<Reply> drain() {
+        std::uint64_t count;
+        ssize_t n = ::read(efd_, &count, sizeof(count));
+        (void)n;
+        std::vector<Reply> out;
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.swap(replies_);
+        return out;
+    }
+
+private:
+    int efd_;
+    std::mutex mutex_;
+    std::vector<Reply> replies_;
+};
+
+// Output bytes a client has been handed but not yet read. Workers never
+// wait on a client: once OUTPUT_CAP bytes are outstanding the command's
+// stream fails, the command stops early and its reply ends with a
+// truncation note. The event loop releases bytes as it writes them and
+// cancels the flow when the client goes away.
+constexpr std::size_t OUTPUT_CAP = 4 << 20;
+
+class Flow {
+public:
+    // Returns false if n more bytes would pass the cap or the client is gone.
+    bool try_acquire(std::size_t n) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (cancelled_ || pending_ + n > OUTPUT_CAP) return false;
+        pending_ += n;
+        return true;
+    }
+
+    void release(std::size_t n) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ -= std::min(n, pending_);
+    }
+
+    void cancel() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::size_t pending_ = 0;
+    bool cancelled_ = false;
+};
+
+// Streams command output to the client in DATA frames as it is produced,
+// instead of buffering the whole response.
+class FrameStreamBuf : public std::streambuf {
+public:
+    FrameStreamBuf(ReplyQueue& queue, std::uint64_t client, Flow& flow)
+        : queue_(queue), client_(client), flow_(flow), buf_(proto::DATA_CHUNK) {
+        setp(buf_.data(), buf_.data() + buf_.size());
+    }
+
+    bool truncated() const { return truncated_; }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (!ship()) return traits_type::eof();   // over the cap: fail the stream
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override {
+        return ship() ? 0 : -1;
+    }
+
+private:
+    bool ship() {
+        std::size_t n = static_cast<std::size_t>(pptr() - pbase());
+        setp(buf_.data(), buf_.data() + buf_.size());
+        if (n == 0) return true;
+        if (truncated_ || !flow_.try_acquire(n + proto::HEADER_SIZE)) {
+            truncated_ = true;
+            return false;
+        }
+        queue_.push({client_, proto::DATA, std::string(buf_.data(), n)});
+        return true;
+    }
+
+    ReplyQueue& queue_;
+    std::uint64_t client_;
+    Flow& flow_;
+    std::vector<char> buf_;
+    bool truncated_ = false;
+};
+
+// ===== Shared worker pool =====
+class WorkerPool {
+public:
+    explicit WorkerPool(unsigned threads) {
+        for (unsigned i = 0; i < threads; ++i)
+            threads_.emplace_back([this] { work(); });
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : threads_) t.join();
+    }
+
+    void submit(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(std::move(job));
+        }
+        cv_.notify_one();
+    }
+
+private:
+    void work() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+                if (stop_ && jobs_.empty()) return;
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> jobs_;
+    bool stop_ = false;
+};
+
+// ===== Event loop =====
+constexpr std::uint64_t LISTEN_TAG = 0;
+constexpr std::uint64_t WAKE_TAG = 1;
+constexpr std::uint64_t SIGNAL_TAG = 2;
+constexpr std::uint64_t FIRST_CLIENT = 16;
+constexpr std::size_t OUT_HIGH_WATER = 1 << 20;
+constexpr std::size_t IN_HIGH_WATER = 4 * (proto::MAX_REQUEST + proto::HEADER_SIZE);
+
+struct Client {
+    int fd;
+    Session session;
+    std::shared_ptr<Flow> flow = std::make_shared<Flow>();
+    std::string in;
+    std::string out;
+    std::size_t out_off = 0;
+    std::uint32_t events = 0;
+    bool busy = false;       // a request is running on the pool
+    bool eof = false;        // peer shut down its write side
+    bool closing = false;    // "exit" received; close once flushed
+};
+
+class Daemon {
+public:
+    Daemon(int listen_fd, int wake_fd, int signal_fd)
+        : listen_fd_(listen_fd), signal_fd_(signal_fd), queue_(wake_fd),
+          pool_(std::max(2u, std::thread::hardware_concurrency())) {
+        epfd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        watch(listen_fd, LISTEN_TAG, EPOLLIN);
+        watch(wake_fd, WAKE_TAG, EPOLLIN);
+        watch(signal_fd, SIGNAL_TAG, EPOLLIN);
+    }
+
+    ~Daemon() {
+        // Make running commands stop producing output before the pool joins.
+        for (auto& [id, c] : clients_) {
+            c->flow->cancel();
+            ::close(c->fd);
+        }
+        ::close(epfd_);
+    }
+
+    void run() {
+        std::vector<epoll_event> events(256);
+        while (true) {
+            int n = ::epoll_wait(epfd_, events.data(), static_cast<int>(events.size()), -1);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "epoll_wait failed: " << strerror(errno) << "\n";
+                return;
+            }
+            for (int i = 0; i < n; ++i) {
+                std::uint64_t tag = events[i].data.u64;
+                if (tag == LISTEN_TAG) accept_clients();
+                else if (tag == WAKE_TAG) deliver_replies();
+                else if (tag == SIGNAL_TAG) return;
+                else client_event(tag, events[i].events);
+            }
+        }
+    }
+
+private:
+    void watch(int fd, std::uint64_t tag, std::uint32_t events) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = tag;
+        ::epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    void accept_clients() {
+        while (true) {
+            int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    std::cerr << "accept failed: " << strerror(errno) << "\n";
+                return;
+            }
+            auto c = std::make_unique<Client>();
+            c->fd = fd;
+            c->session.current = fs::current_path();
+            c->session.cache = &cache_;
+            c->session.threads = &mirror_threads_;
+            c->events = EPOLLIN | EPOLLRDHUP;
+            std::uint64_t id = next_id_++;
+            watch(fd, id, c->events);
+            clients_.emplace(id, std::move(c));
+        }
+    }
+
+    void client_event(std::uint64_t id, std::uint32_t events) {
+        auto it = clients_.find(id);
+        if (it == clients_.end()) return;
+        Client& c = *it->second;
+
+        // Both directions are down (EPOLLHUP cannot be masked). Nothing
+        // more can be delivered, so drop the client now even if a request
+        // is still running; its late replies are discarded.
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            close_client(id);
+            return;
+        }
+        if (events & (EPOLLIN | EPOLLRDHUP)) {
+            char buf[16 * 1024];
+            while (c.in.size() < IN_HIGH_WATER) {
+                ssize_t n = ::read(c.fd, buf, sizeof(buf));
+                if (n > 0) { c.in.append(buf, static_cast<std::size_t>(n)); continue; }
+                if (n == 0) c.eof = true;
+                else if (errno == EINTR) continue;
+                else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    close_client(id);
+                    return;
+                }
+                break;
+            }
+        }
+        if ((events & EPOLLOUT) && !flush(c)) {
+            close_client(id);
+            return;
+        }
+        progress(id, c);
+    }
+
+    // Starts the next queued request if the client is idle, then updates
+    // epoll interest or closes the connection when nothing is left to do.
+    void progress(std::uint64_t id, Client& c) {
+        while (!c.busy && !c.closing && c.out.size() - c.out_off < OUT_HIGH_WATER) {
+            if (c.in.size() >= proto::HEADER_SIZE && proto::peek_length(c.in.data()) > proto::MAX_REQUEST) {
+                close_client(id);
+                return;
+            }
+            proto::FrameType type;
+            std::string line;
+            std::size_t used = proto::parse_frame(c.in.data(), c.in.size(), type, line);
+            if (used == 0) break;
+            c.in.erase(0, used);
+            if (type != proto::REQUEST) {
+                close_client(id);
+                return;
+            }
+            c.busy = true;
+            dispatch(id, std::move(line), c.session, c.flow);
+        }
+
+        bool pending_out = c.out_off < c.out.size();
+        if (!c.busy && !pending_out && (c.closing || c.eof)) {
+            close_client(id);
+            return;
+        }
+        // Stop reading once enough pipelined requests are queued, the same
+        // way EPOLLOUT is only watched while output is pending.
+        bool read_more = !c.eof && !c.closing && c.in.size() < IN_HIGH_WATER;
+        std::uint32_t want = (read_more ? std::uint32_t(EPOLLIN | EPOLLRDHUP) : 0u) |
+                             (pending_out ? std::uint32_t(EPOLLOUT) : 0u);
+        if (want != c.events) {
+            epoll_event ev{};
+            ev.events = want;
+            ev.data.u64 = id;
+            ::epoll_ctl(epfd_, EPOLL_CTL_MOD, c.fd, &ev);
+            c.events = want;
+        }
+    }
+
+    void dispatch(std::uint64_t id, std::string line, Session session, std::shared_ptr<Flow> flow) {
+        ReplyQueue& queue = queue_;
+        pool_.submit([id, line = std::move(line), session, flow, &queue]() mutable {
+            FrameStreamBuf sb(queue, id, *flow);
+            std::ostream os(&sb);
+            bool keep = true;
+            try {
+                keep = run_command(line, session, os);
+            } catch (const std::exception& e) {
+                os << "Error: " << e.what() << "\n";
+            }
+            os.flush();
+            if (sb.truncated())
+                queue.push({id, proto::DATA, "\n[output truncated: client fell too far behind]\n"});
+            Reply end{id, proto::END, session.current.string()};
+            end.quit = !keep;
+            queue.push(std::move(end));
+        });
+    }
+
+    void deliver_replies() {
+        std::vector<std::uint64_t> touched;
+        for (Reply& r : queue_.drain()) {
+            auto it = clients_.find(r.client);
+            if (it == clients_.end()) continue;   // client went away mid-request
+            Client& c = *it->second;
+            proto::append_frame(c.out, r.type, r.payload);
+            if (r.type == proto::END) {
+                c.session.current = r.payload;
+                c.busy = false;
+                c.closing = r.quit;
+            }
+            touched.push_back(r.client);
+        }
+        for (std::uint64_t id : touched) {
+            auto it = clients_.find(id);
+            if (it == clients_.end()) continue;
+            if (!flush(*it->second)) close_client(id);
+            else progress(id, *it->second);
+        }
+    }
+
+    bool flush(Client& c) {
+        while (c.out_off < c.out.size()) {
+            ssize_t n = ::send(c.fd, c.out.data() + c.out_off, c.out.size() - c.out_off,
+                               MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n > 0) {
+                c.out_off += static_cast<std::size_t>(n);
+                c.flow->release(static_cast<std::size_t>(n));
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            return false;
+        }
+        if (c.out_off == c.out.size()) {
+            c.out.clear();
+            c.out_off = 0;
+        } else if (c.out_off > OUT_HIGH_WATER) {
+            c.out.erase(0, c.out_off);
+            c.out_off = 0;
+        }
+        return true;
+    }
+
+    void close_client(std::uint64_t id) {
+        auto it = clients_.find(id);
+        if (it == clients_.end()) return;
+        it->second->flow->cancel();
+        ::epoll_ctl(epfd_, EPOLL_CTL_DEL, it->second->fd, nullptr);
+        ::close(it->second->fd);
+        clients_.erase(it);
+    }
+
+    int epfd_;
+    int listen_fd_;
+    int signal_fd_;
+    ReplyQueue queue_;
+    DirCache cache_;
+    ThreadBudget mirror_threads_{std::max(2u, std::thread::hardware_concurrency())};
+    std::unordered_map<std::uint64_t, std::unique_ptr<Client>> clients_;
+    std::uint64_t next_id_ = FIRST_CLIENT;
+    WorkerPool pool_;   // last: joined before the queue and cache go away
+};
+
+int open_listener(const std::string& path) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path too long: " << path << "\n";
+        return -1;
+    }
+
+    // Refuse to steal the socket from a live daemon; clear a stale one.
+    int probe = proto::connect_socket(path);
+    if (probe >= 0) {
+        ::close(probe);
+        std::cerr << "A daemon is already listening on " << path << "\n";
+        return -1;
+    }
+    ::unlink(path.c_str());
+
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    // Commands run as the daemon's user, so the socket is owner-only from
+    // the moment it exists.
+    mode_t old_mask = ::umask(077);
+    bool bound = fd >= 0 && ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    ::umask(old_mask);
+    if (!bound || ::listen(fd, SOMAXCONN) != 0) {
+        std::cerr << "Cannot listen on " << path << ": " << strerror(errno) << "\n";
+        if (fd >= 0) ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+} // namespace
+
+// ===== Daemon Mode =====
+int run_daemon(const std::string& socket_path) {
+    int listen_fd = open_listener(socket_path);
+    if (listen_fd < 0) return 1;
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);   // before the pool threads start
+    int signal_fd = ::signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    int wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (signal_fd < 0 || wake_fd < 0) {
+        std::cerr << "Cannot set up event loop: " << strerror(errno) << "\n";
+        ::close(listen_fd);
+        ::unlink(socket_path.c_str());
+        return 1;
+    }
+
+    std::cout << "Serving on " << socket_path << "\n" << std::flush;
+    {
+        Daemon daemon(listen_fd, wake_fd, signal_fd);
+        daemon.run();
+    }
+
+    ::close(wake_fd);
+    ::close(signal_fd);
+    ::close(listen_fd);
+    ::unlink(socket_path.c_str());
+    std::cout << "Daemon stopped.\n";
+    return 0;
+}
+
+// ===== Client Mode =====
+int run_client(const std::string& socket_path) {
+    int fd = proto::connect_socket(socket_path);
+    if (fd < 0) {
+        std::cerr << "Cannot connect to " << socket_path << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+
+    // Start the remote session in our own working directory.
+    std::string current;
+    std::string line = "cd " + fs::current_path().string();
+    while (true) {
+        if (!proto::send_request(fd, line)) break;
+        proto::FrameType type;
+        std::string payload;
+        bool ended = false;
+        while (proto::read_frame(fd, type, payload)) {
+            if (type == proto::DATA) std::cout << payload << std::flush;
+            else if (type == proto::END) { current = payload; ended = true; break; }
+        }
+        if (!ended) {
+            if (line != "exit") std::cerr << "Connection to daemon lost.\n";
+            break;
+        }
+        if (line == "exit") break;
+
+        do {
+            std::cout << current << " $ ";
+            if (!std::getline(std::cin, line)) line = "exit";
+        } while (line.empty());
+    }
+
+    ::close(fd);
+    return 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+
+// Serves the command set to many clients over a Unix-domain socket. All
+// clients share one DirCache and one worker pool; each keeps its own working
+// directory. Runs until SIGINT/SIGTERM and returns the process exit code.
+int run_daemon(const std::string& socket_path);
+
+// Interactive thin client for a running daemon.
+int run_client(const std::string& socket_path);
@@ -1,21 +1,55 @@
 #include "explorer.hpp"
 #include <filesystem>
 #include <iostream>
+#include <mutex>          // std::unique_lock
 
 namespace fs = std::filesystem;
 
-std::vector<Entry> list_directory(const std::string& path) {
+std::vector<Entry> list_directory(const std::string& path, std::ostream& err, bool* complete) {
     std::vector<Entry> entries;
-    try {
-        for (const auto& p : fs::directory_iterator(path)) {
-            Entry e;
-            e.name = p.path().filename().string();
-            e.is_dir = fs::is_directory(p);
-            e.size = e.is_dir ? 0 : fs::file_size(p);
-            entries.push_back(e);
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "Error reading directory: " << e.what() << '\n';
+    std::error_code ec;
+    fs::directory_iterator it(path, ec);
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        // One stat per entry; dangling symlinks fall back to the link itself.
+        std::error_code sec;
+        fs::file_status st = it->status(sec);
+        if (sec) st = it->symlink_status(sec);
+        Entry e;
+        e.name = it->path().filename().string();
+        e.is_dir = fs::is_directory(st);
+        e.size = fs::is_regular_file(st) ? it->file_size(sec) : 0;
+        if (sec) e.size = 0;
+        e.perms = st.permissions();
+        entries.push_back(e);
     }
+    if (ec) err << "Error reading directory: " << ec.message() << '\n';
+    if (complete) *complete = !ec;
     return entries;
 }
+
+DirCache::Listing DirCache::get(const std::string& path, std::ostream& err) {
+    std::error_code ec;
+    auto mtime = fs::last_write_time(path, ec);
+    if (ec) return std::make_shared<const std::vector<Entry>>(list_directory(path, err));
+
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = slots_.find(path);
+        if (it != slots_.end() && it->second.mtime == mtime && now - it->second.loaded < ttl_)
+            return it->second.entries;
+    }
+
+    bool complete = true;
+    Listing fresh = std::make_shared<const std::vector<Entry>>(list_directory(path, err, &complete));
+    if (!complete) return fresh;
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (slots_.size() >= max_dirs_ && !slots_.count(path)) slots_.clear();
+    slots_[path] = Slot{mtime, now, fresh};
+    return fresh;
+}
+
+void DirCache::invalidate(const std::string& path) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    slots_.erase(path);
+}
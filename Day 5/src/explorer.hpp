@@ -2,11 +2,48 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <memory>
+#include <chrono>
+#include <shared_mutex>
+#include <unordered_map>
 
 struct Entry {
     std::string name;
     bool is_dir;
     std::uintmax_t size;
+    std::filesystem::perms perms = std::filesystem::perms::unknown;
 };
 
-std::vector<Entry> list_directory(const std::string& path);
+// Errors are reported to err. If complete is given, it is set to false when
+// the directory could not be read in full.
+std::vector<Entry> list_directory(const std::string& path, std::ostream& err, bool* complete = nullptr);
+
+// Directory listings shared between sessions. A listing is reused while the
+// directory's mtime is unchanged and it is younger than the TTL, so in-place
+// size changes show up after at most one TTL. Listings that hit an error are
+// returned but never cached.
+class DirCache {
+public:
+    using Listing = std::shared_ptr<const std::vector<Entry>>;
+
+    explicit DirCache(std::chrono::milliseconds ttl = std::chrono::milliseconds(1000),
+                      std::size_t max_dirs = 4096)
+        : ttl_(ttl), max_dirs_(max_dirs) {}
+
+    Listing get(const std::string& path, std::ostream& err);
+    void invalidate(const std::string& path);
+
+private:
+    struct Slot {
+        std::filesystem::file_time_type mtime;
+        std::chrono::steady_clock::time_point loaded;
+        Listing entries;
+    };
+
+    std::chrono::milliseconds ttl_;
+    std::size_t max_dirs_;
+    std::shared_mutex mutex_;
+    std::unordered_map<std::string, Slot> slots_;
+};
@@ -0,0 +1,126 @@
+// Load generator for the explorer daemon: opens N client connections, each
+// sending M requests back to back, and reports throughput and latency.
+// --stall K first parks K extra clients that send a large command and never
+// read its reply; the measured clients must still be served.
+#include "protocol.hpp"
+#include <filesystem>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <sys/time.h>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+constexpr int REPLY_TIMEOUT_SEC = 10;   // a stuck daemon shows up as failures
+
+// Sends one request and waits for its END frame. Returns false on I/O error.
+bool round_trip(int fd, const std::string& line) {
+    if (!proto::send_request(fd, line)) return false;
+    proto::FrameType type;
+    std::string payload;
+    while (proto::read_frame(fd, type, payload))
+        if (type == proto::END) return true;
+    return false;
+}
+
+int main(int argc, char** argv) {
+    std::string socket_path = proto::default_socket();
+    std::string command = "ls";
+    int clients = 16;
+    int requests = 1000;
+    int stalled = 0;
+    std::string stall_command = "find .";
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) socket_path = argv[++i];
+        else if (arg == "-c" && i + 1 < argc) clients = std::stoi(argv[++i]);
+        else if (arg == "-n" && i + 1 < argc) requests = std::stoi(argv[++i]);
+        else if (arg == "--cmd" && i + 1 < argc) command = argv[++i];
+        else if (arg == "--stall" && i + 1 < argc) stalled = std::stoi(argv[++i]);
+        else if (arg == "--stall-cmd" && i + 1 < argc) stall_command = argv[++i];
+        else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--socket <path>] [-c clients] [-n requests-per-client] [--cmd <command>]"
+                      << " [--stall clients] [--stall-cmd <command>]\n";
+            return 1;
+        }
+    }
+    if (clients < 1 || requests < 1 || stalled < 0) {
+        std::cerr << "Client and request counts must be positive.\n";
+        return 1;
+    }
+
+    std::string start_dir = "cd " + fs::current_path().string();
+
+    // Clients that ask for output and then stop reading, like a paused pager.
+    std::vector<int> stall_fds;
+    for (int i = 0; i < stalled; ++i) {
+        int fd = proto::connect_socket(socket_path);
+        if (fd < 0 || !proto::send_request(fd, start_dir) || !proto::send_request(fd, stall_command)) {
+            std::cerr << "Cannot open stalled client " << i << "\n";
+            if (fd >= 0) ::close(fd);
+            continue;
+        }
+        stall_fds.push_back(fd);
+    }
+    std::vector<std::vector<double>> latencies(clients);
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+
+    auto begin = Clock::now();
+    for (int t = 0; t < clients; ++t) {
+        threads.emplace_back([&, t] {
+            int fd = proto::connect_socket(socket_path);
+            timeval tv{REPLY_TIMEOUT_SEC, 0};
+            if (fd >= 0) ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            if (fd < 0 || !round_trip(fd, start_dir)) {
+                ++failures;
+                if (fd >= 0) ::close(fd);
+                return;
+            }
+            auto& lat = latencies[t];
+            lat.reserve(requests);
+            for (int i = 0; i < requests; ++i) {
+                auto t0 = Clock::now();
+                if (!round_trip(fd, command)) {
+                    ++failures;
+                    break;
+                }
+                lat.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+            }
+            ::close(fd);
+        });
+    }
+    for (auto& th : threads) th.join();
+    double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+    for (int fd : stall_fds) ::close(fd);
+
+    std::vector<double> all;
+    for (auto& lat : latencies) all.insert(all.end(), lat.begin(), lat.end());
+    if (all.empty()) {
+        std::cerr << "No requests completed (is the daemon running on " << socket_path << "?)\n";
+        return 1;
+    }
+    std::sort(all.begin(), all.end());
+    auto pct = [&](double p) {
+        std::size_t idx = static_cast<std::size_t>(p * (all.size() - 1));
+        return all[idx];
+    };
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "Clients:      " << clients << " (+" << stall_fds.size() << " stalled)\n"
+              << "Requests:     " << all.size() << " (" << failures << " failed)\n"
+              << "Elapsed:      " << elapsed << " s\n"
+              << "Throughput:   " << all.size() / elapsed << " req/s\n"
+              << "Latency p50:  " << pct(0.50) << " us\n"
+              << "Latency p99:  " << pct(0.99) << " us\n"
+              << "Latency max:  " << all.back() << " us\n";
+    return failures ? 1 : 0;
+}
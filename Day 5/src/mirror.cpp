@@ -0,0 +1,431 @@
+#include "mirror.hpp"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <cerrno>
+#include <cstring>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct ManifestEntry {
+    char type = 'F';            // 'F' regular file, 'D' directory
+    std::uintmax_t size = 0;
+    long long mtime = 0;        // nanoseconds since the epoch
+};
+
+struct MirrorStats {
+    std::atomic<std::uintmax_t> transferred{0};   // new data read from the source
+    std::atomic<std::uintmax_t> reused{0};        // old destination blocks kept
+    std::atomic<std::uintmax_t> skipped{0};
+    std::atomic<std::size_t> copied{0};
+    std::atomic<std::size_t> deleted{0};
+    std::atomic<std::size_t> failed{0};
+};
+
+const char* MANIFEST_NAME = ".mirror_manifest";
+const std::size_t DELTA_BLOCK = 64 * 1024;
+const std::uintmax_t DELTA_MIN_SIZE = 4 * DELTA_BLOCK;
+
+// One stat per entry: type, size and mtime together. Follows symlinks.
+bool stat_entry(const fs::path& p, ManifestEntry& e) {
+#ifndef _WIN32
+    struct stat st;
+    if (::stat(p.c_str(), &st) != 0) return false;
+    e.type = S_ISDIR(st.st_mode) ? 'D' : S_ISREG(st.st_mode) ? 'F' : '?';
+    e.size = S_ISREG(st.st_mode) ? static_cast<std::uintmax_t>(st.st_size) : 0;
+    e.mtime = static_cast<long long>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    return true;
+#else
+    std::error_code ec;
+    fs::file_status s = fs::status(p, ec);
+    if (ec) return false;
+    e.type = fs::is_directory(s) ? 'D' : fs::is_regular_file(s) ? 'F' : '?';
+    e.size = e.type == 'F' ? fs::file_size(p, ec) : 0;
+    e.mtime = static_cast<long long>(fs::last_write_time(p, ec).time_since_epoch().count());
+    return !ec;
+#endif
+}
+
+std::map<std::string, ManifestEntry> load_manifest(const fs::path& file) {
+    std::map<std::string, ManifestEntry> m;
+    std::ifstream in(file);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        ManifestEntry e;
+        std::string rel;
+        if (ss >> e.type >> e.size >> e.mtime && std::getline(ss >> std::ws, rel))
+            m[rel] = e;
+    }
+    return m;
+}
+
+bool save_manifest(const fs::path& file, const std::map<std::string, ManifestEntry>& m) {
+    fs::path tmp = file;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ofstream::trunc);
+        for (const auto& [rel, e] : m)
+            out << e.type << ' ' << e.size << ' ' << e.mtime << ' ' << rel << '\n';
+        if (!out) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, file, ec);
+    return !ec;
+}
+
+#ifndef _WIN32
+// rsync-style weak checksum over a window; rolls one byte in O(1).
+struct RollingSum {
+    std::uint32_t a = 0, b = 0;
+    std::size_t len = 0;
+
+    void init(const unsigned char* p, std::size_t n) {
+        a = b = 0;
+        len = n;
+        for (std::size_t i = 0; i < n; ++i) {
+            a += p[i];
+            b += static_cast<std::uint32_t>(n - i) * p[i];
+        }
+    }
+    void roll(unsigned char out, unsigned char in) {
+        a += in - out;
+        b += a - static_cast<std::uint32_t>(len) * out;
+    }
+    std::uint32_t digest() const { return (a & 0xffff) | (b << 16); }
+};
+
+std::size_t strong_sum(const char* p, std::size_t n) {
+    return std::hash<std::string_view>{}(std::string_view(p, n));
+}
+
+bool write_fd(int fd, const char* p, std::size_t n) {
+    while (n > 0) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        p += w;
+        n -= static_cast<std::size_t>(w);
+    }
+    return true;
+}
+
+bool read_fd(int fd, char* p, std::size_t n, std::size_t& got) {
+    got = 0;
+    while (got < n) {
+        ssize_t r = ::read(fd, p + got, n - got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) return false;
+        if (r == 0) break;
+        got += static_cast<std::size_t>(r);
+    }
+    return true;
+}
+
+// Rebuilds dst from src with rolling checksums, so blocks of the old dst
+// are found again even when src content has shifted. Memory is bounded:
+// one checksum pair per dst block plus a few block-sized buffers. The new
+// file is assembled in dst.mirror.tmp and renamed over dst. `literal` is
+// the data taken from src, `reused` the bytes copied from old dst blocks.
+bool delta_copy(const fs::path& src, const fs::path& dst, std::uintmax_t& literal, std::uintmax_t& reused) {
+    const std::size_t B = DELTA_BLOCK;
+    int basis = ::open(dst.c_str(), O_RDONLY | O_CLOEXEC);
+    if (basis < 0) return false;
+    int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (in < 0 || ::fstat(in, &st) != 0) {
+        if (in >= 0) ::close(in);
+        ::close(basis);
+        return false;
+    }
+    fs::path tmp = dst;
+    tmp += ".mirror.tmp";
+    int outfd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777);
+    if (outfd < 0) {
+        ::close(in);
+        ::close(basis);
+        return false;
+    }
+
+    bool ok = true;
+    std::vector<char> blk(B);
+
+    // Pass 1: checksum every whole block of the old dst.
+    std::unordered_multimap<std::uint32_t, std::size_t> weak;
+    std::vector<std::size_t> strong;
+    RollingSum rs;
+    for (std::size_t got; ok;) {
+        ok = read_fd(basis, blk.data(), B, got);
+        if (!ok || got < B) break;
+        rs.init(reinterpret_cast<unsigned char*>(blk.data()), B);
+        weak.emplace(rs.digest(), strong.size());
+        strong.push_back(strong_sum(blk.data(), B));
+    }
+
+    // Pass 2: slide a block-sized window over src. buf[lit, start) is
+    // literal data not yet written; the window is buf[start, start + B).
+    std::vector<char> buf(4 * B);
+    std::size_t start = 0, end = 0, lit = 0;
+    bool eof = false, have_sum = false;
+    literal = reused = 0;
+    auto emit_literal = [&](std::size_t upto) {
+        if (upto > lit && !write_fd(outfd, buf.data() + lit, upto - lit)) ok = false;
+        literal += upto - lit;
+        lit = upto;
+    };
+    auto refill = [&] {
+        emit_literal(start);
+        std::memmove(buf.data(), buf.data() + start, end - start);
+        end -= start;
+        start = lit = 0;
+        std::size_t got;
+        if (!read_fd(in, buf.data() + end, buf.size() - end, got)) ok = false;
+        if (got == 0) eof = true;
+        end += got;
+    };
+
+    while (ok && !strong.empty()) {
+        if (end - start <= B && !eof) { refill(); continue; }
+        if (end - start < B) break;
+        const unsigned char* w = reinterpret_cast<unsigned char*>(buf.data() + start);
+        if (!have_sum) { rs.init(w, B); have_sum = true; }
+
+        bool matched = false;
+        auto range = weak.equal_range(rs.digest());
+        if (range.first != range.second) {
+            std::size_t s = strong_sum(buf.data() + start, B);
+            for (auto it = range.first; it != range.second && !matched; ++it) {
+                off_t off = static_cast<off_t>(it->second) * static_cast<off_t>(B);
+                matched = strong[it->second] == s &&
+                          ::pread(basis, blk.data(), B, off) == static_cast<ssize_t>(B) &&
+                          std::memcmp(blk.data(), buf.data() + start, B) == 0;
+            }
+        }
+        if (matched) {
+            emit_literal(start);
+            if (ok && !write_fd(outfd, blk.data(), B)) ok = false;
+            reused += B;
+            start += B;
+            lit = start;
+            have_sum = false;
+        } else {
+            if (end - start > B) rs.roll(w[0], w[B]);
+            else have_sum = false;
+            ++start;
+        }
+    }
+    // Whatever is left (or all of src when dst had no whole block) is literal.
+    while (ok) {
+        start = end;
+        emit_literal(end);
+        if (eof) break;
+        refill();
+    }
+
+    if (::close(outfd) != 0) ok = false;
+    ::close(in);
+    ::close(basis);
+    std::error_code ec;
+    if (ok) fs::rename(tmp, dst, ec);
+    if (!ok || ec) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+#endif
+
+template <typename Job>
+void run_parallel(std::vector<Job>& jobs, const std::function<void(Job&)>& work, ThreadBudget* budget) {
+    if (jobs.empty()) return;
+    unsigned want = std::min<unsigned>(std::min(std::thread::hardware_concurrency(), 8u),
+                                       static_cast<unsigned>(jobs.size())) - 1;
+    unsigned extra = budget ? budget->acquire(want) : want;
+    std::atomic<std::size_t> next{0};
+    auto drain = [&] {
+        for (std::size_t i; (i = next++) < jobs.size();) work(jobs[i]);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < extra; ++t) pool.emplace_back(drain);
+    drain();   // the caller always takes part, so a mirror makes progress with no grant
+    for (auto& t : pool) t.join();
+    if (budget) budget->release(extra);
+}
+
+struct CopyJob {
+    std::string rel;
+    std::uintmax_t size;
+    bool ok = false;
+};
+
+// Replaces whatever sits at `to` (including a symlink) unless it is already
+// a real directory, so copies never follow links out of the tree.
+bool ensure_directory(const fs::path& to) {
+    std::error_code ec;
+    fs::file_status s = fs::symlink_status(to, ec);
+    if (fs::is_directory(s)) return true;
+    if (fs::exists(s)) fs::remove_all(to, ec);
+    return fs::create_directory(to, ec) && !ec;
+}
+
+bool copy_one(const fs::path& from, const fs::path& to, std::uintmax_t size, MirrorStats& stats) {
+    std::error_code ec;
+    fs::file_status s = fs::symlink_status(to, ec);
+    // Never write through a link or onto a directory: replace it.
+    if (fs::is_directory(s) || fs::is_symlink(s)) {
+        fs::remove_all(to, ec);
+        if (ec) return false;
+    }
+#ifndef _WIN32
+    std::uintmax_t literal = 0, reused = 0;
+    if (fs::is_regular_file(s) && size >= DELTA_MIN_SIZE && delta_copy(from, to, literal, reused)) {
+        stats.transferred += literal;
+        stats.reused += reused;
+        return true;
+    }
+#endif
+    fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+    if (ec == std::errc::no_such_file_or_directory) {
+        // The destination directory vanished behind the manifest's back.
+        ec.clear();
+        fs::create_directories(to.parent_path(), ec);
+        if (!ec) fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+    }
+    if (ec) return false;
+    stats.transferred += size;
+    return true;
+}
+
+} // namespace
+
+unsigned ThreadBudget::acquire(unsigned want) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    unsigned n = std::min(want, free_);
+    free_ -= n;
+    return n;
+}
+
+void ThreadBudget::release(unsigned n) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_ += n;
+}
+
+// ===== Mirror Command =====
+void mirror_tree(const fs::path& src, const fs::path& dst, std::ostream& out, ThreadBudget* budget) {
+    std::error_code ec;
+    if (!fs::is_directory(src, ec)) {
+        out << "Mirror source is not a directory.\n";
+        return;
+    }
+    if (fs::is_symlink(fs::symlink_status(dst, ec))) {
+        out << "Mirror destination must not be a symlink.\n";
+        return;
+    }
+    fs::create_directories(dst, ec);
+    if (ec) {
+        out << "Cannot create " << dst.string() << ": " << ec.message() << "\n";
+        return;
+    }
+    if (fs::equivalent(src, dst, ec)) {
+        out << "Mirror source and destination are the same directory.\n";
+        return;
+    }
+
+    fs::path manifest_file = dst / MANIFEST_NAME;
+    auto old_manifest = load_manifest(manifest_file);
+    std::map<std::string, ManifestEntry> new_manifest;
+    std::vector<CopyJob> copies;
+    MirrorStats stats;
+
+    fs::recursive_directory_iterator it(src, fs::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        const fs::path& from = it->path();
+        std::string rel = from.lexically_relative(src).generic_string();
+        ManifestEntry e;
+        if (!stat_entry(from, e)) continue;
+        auto old = old_manifest.find(rel);
+        bool unchanged = old != old_manifest.end() && old->second.type == e.type;
+
+        if (e.type == 'D') {
+            std::error_code eq;
+            if (fs::equivalent(from, dst, eq)) { it.disable_recursion_pending(); continue; }
+            // One lstat per directory: also catches a dst dir swapped for a symlink.
+            if (!ensure_directory(dst / rel)) {
+                ++stats.failed;
+                it.disable_recursion_pending();
+                continue;
+            }
+            new_manifest[rel] = e;
+            continue;
+        }
+        if (e.type != 'F') continue;
+
+        new_manifest[rel] = e;
+        if (unchanged && old->second.size == e.size && old->second.mtime == e.mtime) {
+            stats.skipped += e.size;
+            continue;
+        }
+        copies.push_back({rel, e.size});
+    }
+    if (ec) {
+        out << "Mirror scan error: " << ec.message() << "\n";
+        return;
+    }
+
+    // Entries gone from the source. A removed directory takes its contents
+    // with it, so skip anything beneath one to keep the workers disjoint.
+    std::vector<std::string> deletions;
+    for (const auto& [rel, e] : old_manifest) {
+        if (new_manifest.count(rel)) continue;
+        bool covered = false;
+        for (fs::path p = fs::path(rel).parent_path(); !p.empty() && !covered; p = p.parent_path()) {
+            auto gone = old_manifest.find(p.generic_string());
+            covered = gone != old_manifest.end() && gone->second.type == 'D' && !new_manifest.count(gone->first);
+        }
+        if (!covered) deletions.push_back(rel);
+    }
+
+    run_parallel<std::string>(deletions, [&](std::string& rel) {
+        std::error_code rec;
+        fs::remove_all(dst / rel, rec);
+        if (rec) ++stats.failed;
+        else ++stats.deleted;
+    }, budget);
+
+    run_parallel<CopyJob>(copies, [&](CopyJob& job) {
+        try {
+            job.ok = copy_one(src / job.rel, dst / job.rel, job.size, stats);
+        } catch (...) {
+            job.ok = false;
+        }
+        if (job.ok) ++stats.copied;
+        else ++stats.failed;
+    }, budget);
+
+    // Drop failed copies so they are retried on the next run.
+    for (const auto& job : copies)
+        if (!job.ok) new_manifest.erase(job.rel);
+    if (!save_manifest(manifest_file, new_manifest))
+        out << "Warning: could not write manifest.\n";
+
+    out << "Mirrored " << stats.copied << " file(s), deleted " << stats.deleted;
+    if (stats.failed) out << ", " << stats.failed << " failed";
+    out << "\n" << stats.transferred + stats.reused << " bytes written ("
+        << stats.transferred << " new, " << stats.reused << " reused), "
+        << stats.skipped << " bytes skipped\n";
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <filesystem>
+#include <ostream>
+#include <mutex>
+
+// Helper threads mirror may start, shared by every session that holds it.
+// Grants never block; a mirror that gets none runs on the calling thread.
+class ThreadBudget {
+public:
+    explicit ThreadBudget(unsigned limit) : free_(limit) {}
+    unsigned acquire(unsigned want);
+    void release(unsigned n);
+
+private:
+    std::mutex mutex_;
+    unsigned free_;
+};
+
+// Incrementally copies the src tree into dst. A manifest in dst records
+// (type, size, mtime) per entry so repeat runs only copy what changed;
+// entries removed from src are removed from dst. Without a budget, up to
+// seven helper threads are started per call.
+void mirror_tree(const std::filesystem::path& src, const std::filesystem::path& dst, std::ostream& out,
+                 ThreadBudget* budget = nullptr);
@@ -0,0 +1,114 @@
+#pragma once
+// Wire format shared by the daemon, the thin client and the load tester.
+//
+// Every message is a frame: u32 payload length (big endian), u8 type, payload.
+// A client sends one REQUEST (a command line) and waits for the reply, which
+// is zero or more DATA frames carrying output followed by one END frame whose
+// payload is the session's working directory. A client may pipeline requests;
+// replies come back in order.
+#include <cstdint>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace proto {
+
+enum FrameType : std::uint8_t { REQUEST = 1, DATA = 2, END = 3 };
+
+constexpr std::size_t HEADER_SIZE = 5;
+constexpr std::size_t MAX_REQUEST = 64 * 1024;
+constexpr std::size_t DATA_CHUNK = 64 * 1024;
+
+// Per-user socket: $XDG_RUNTIME_DIR when set, else a uid-suffixed name in /tmp.
+inline std::string default_socket() {
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) return std::string(runtime) + "/fileexplorer.sock";
+    return "/tmp/fileexplorer-" + std::to_string(::getuid()) + ".sock";
+}
+
+inline void append_frame(std::string& buf, FrameType type, const char* data, std::size_t len) {
+    char hdr[HEADER_SIZE] = {
+        static_cast<char>((len >> 24) & 0xff), static_cast<char>((len >> 16) & 0xff),
+        static_cast<char>((len >> 8) & 0xff),  static_cast<char>(len & 0xff),
+        static_cast<char>(type)};
+    buf.append(hdr, HEADER_SIZE);
+    buf.append(data, len);
+}
+
+inline void append_frame(std::string& buf, FrameType type, const std::string& payload) {
+    append_frame(buf, type, payload.data(), payload.size());
+}
+
+inline std::size_t peek_length(const char* buf) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(buf);
+    return (std::size_t(p[0]) << 24) | (std::size_t(p[1]) << 16) |
+           (std::size_t(p[2]) << 8) | std::size_t(p[3]);
+}
+
+// Parses a frame at the start of buf. Returns the number of bytes consumed,
+// or 0 if the frame is not complete yet.
+inline std::size_t parse_frame(const char* buf, std::size_t len, FrameType& type, std::string& payload) {
+    if (len < HEADER_SIZE) return 0;
+    std::size_t n = peek_length(buf);
+    if (len < HEADER_SIZE + n) return 0;
+    type = static_cast<FrameType>(buf[4]);
+    payload.assign(buf + HEADER_SIZE, n);
+    return HEADER_SIZE + n;
+}
+
+// ===== Blocking helpers for clients =====
+inline bool write_all(int fd, const char* data, std::size_t len) {
+    while (len > 0) {
+        ssize_t n = ::send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+inline bool read_all(int fd, char* data, std::size_t len) {
+    while (len > 0) {
+        ssize_t n = ::read(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+inline bool send_request(int fd, const std::string& line) {
+    std::string buf;
+    append_frame(buf, REQUEST, line);
+    return write_all(fd, buf.data(), buf.size());
+}
+
+inline bool read_frame(int fd, FrameType& type, std::string& payload) {
+    char hdr[HEADER_SIZE];
+    if (!read_all(fd, hdr, HEADER_SIZE)) return false;
+    type = static_cast<FrameType>(hdr[4]);
+    payload.resize(peek_length(hdr));
+    return read_all(fd, &payload[0], payload.size());
+}
+
+inline int connect_socket(const std::string& path) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) return -1;
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+} // namespace proto